@@ -8,6 +8,18 @@
 #include <bitset>
 #include <cctype>
 #include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 // Instruction formats as per myRV32I specification
 enum class InstructionFormat {
@@ -40,6 +52,37 @@ struct Symbol {
     uint32_t address;
 };
 
+// Source line structure holding the tokens of one preprocessed line
+struct SourceLine {
+    std::string label;                  // label defined on this line (may be empty)
+    std::string mnemonic;               // instruction, directive or macro name (may be empty)
+    std::vector<std::string> operands;  // comma-separated operands
+    const std::string* file;            // canonical path of the originating file
+    int lineNumber;                     // line number within that file
+};
+
+// Macro structure for .macro/.endm definitions
+struct Macro {
+    std::string name;
+    std::vector<std::string> params;
+    std::vector<SourceLine> body;
+};
+
+// Preprocessor state shared across included files and macro expansions
+struct Preprocessor {
+    std::unordered_map<std::string, std::vector<SourceLine>> fileCache; // token streams by canonical path
+    std::unordered_map<std::string, Macro> macros;
+    std::unordered_map<std::string, std::string> equates;
+    std::unordered_map<std::string, int> registers;     // register names, which .equ may not redefine
+    std::vector<std::string> includeStack;
+    int expansionDepth = 0;
+    int uniqueCounter = 0;
+    std::vector<SourceLine> output;
+};
+
+// Limit on nested macro/.rept expansion, to catch recursive macros
+const int MAX_EXPANSION_DEPTH = 256;
+
 // Function to trim whitespace from start and end of a string
 std::string trim(const std::string& str) {
     size_t first = str.find_first_not_of(" \t\n\r");
@@ -291,7 +334,10 @@ std::pair<int, int> parseMemoryOperand(const std::string& operand, const std::un
     std::string offsetStr = trim(operand.substr(0, openParen));
     std::string regStr = trim(operand.substr(openParen + 1, closeParen - openParen - 1));
     
-    int offset = isNumber(offsetStr) ? parseNumber(offsetStr) : 0;
+    if (!offsetStr.empty() && !isNumber(offsetStr)) {
+        throw std::runtime_error("Invalid memory offset: " + offsetStr);
+    }
+    int offset = offsetStr.empty() ? 0 : parseNumber(offsetStr);
     
     auto regIt = registers.find(regStr);
     if (regIt == registers.end()) {
@@ -301,24 +347,26 @@ std::pair<int, int> parseMemoryOperand(const std::string& operand, const std::un
     return {offset, regIt->second};
 }
 
-// Parse and assemble a single instruction
-uint32_t assembleInstruction(const std::string& instructionStr, 
+// Function to rebuild the text of an instruction from its tokens (used for error messages)
+std::string formatInstruction(const std::string& mnemonic, const std::vector<std::string>& operands) {
+    std::string text = mnemonic;
+    for (size_t i = 0; i < operands.size(); i++) {
+        text += (i == 0) ? " " : ", ";
+        text += operands[i];
+    }
+    return text;
+}
+
+// Parse and assemble a single instruction from its mnemonic and operand tokens
+uint32_t assembleInstruction(const std::string& mnemonic,
+                            const std::vector<std::string>& operands,
                             const std::unordered_map<std::string, Instruction>& instructions,
                             const std::unordered_map<std::string, int>& registers,
                             const std::unordered_map<std::string, uint32_t>& symbolTable,
                             uint32_t currentAddress) {
-    // Split instruction into opcode and operands
-    size_t spacePos = instructionStr.find(' ');
-    if (spacePos == std::string::npos) {
-        throw std::runtime_error("Invalid instruction format: " + instructionStr);
-    }
-    
-    std::string opcode = trim(instructionStr.substr(0, spacePos));
+    std::string opcode = mnemonic;
     std::transform(opcode.begin(), opcode.end(), opcode.begin(), ::tolower);
     
-    std::string operandsStr = trim(instructionStr.substr(spacePos + 1));
-    std::vector<std::string> operands = parseOperands(operandsStr);
-    
     // Find instruction in the map
     auto it = instructions.find(opcode);
     if (it == instructions.end()) {
@@ -331,7 +379,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
     switch (instr.format) {
         case InstructionFormat::R_TYPE: {
             if (operands.size() != 3) {
-                throw std::runtime_error("R-type instruction requires 3 operands: " + instructionStr);
+                throw std::runtime_error("R-type instruction requires 3 operands: " + formatInstruction(opcode, operands));
             }
             
             // Get register numbers
@@ -350,7 +398,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
             // Handle load instructions specially
             if (opcode == "lb" || opcode == "lh" || opcode == "lw" || opcode == "lbu" || opcode == "lhu") {
                 if (operands.size() != 2) {
-                    throw std::runtime_error("Load instruction requires 2 operands: " + instructionStr);
+                    throw std::runtime_error("Load instruction requires 2 operands: " + formatInstruction(opcode, operands));
                 }
                 
                 auto rdIt = registers.find(operands[0]);
@@ -364,7 +412,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
             // Handle JALR specially
             else if (opcode == "jalr") {
                 if (operands.size() != 3 && operands.size() != 2) {
-                    throw std::runtime_error("JALR instruction requires 2 or 3 operands: " + instructionStr);
+                    throw std::runtime_error("JALR instruction requires 2 or 3 operands: " + formatInstruction(opcode, operands));
                 }
                 
                 int rd, rs1, imm;
@@ -411,7 +459,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
             // Regular I-type instructions
             else {
                 if (operands.size() != 3) {
-                    throw std::runtime_error("I-type instruction requires 3 operands: " + instructionStr);
+                    throw std::runtime_error("I-type instruction requires 3 operands: " + formatInstruction(opcode, operands));
                 }
                 
                 auto rdIt = registers.find(operands[0]);
@@ -437,7 +485,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
         
         case InstructionFormat::S_TYPE: {
             if (operands.size() != 2) {
-                throw std::runtime_error("S-type instruction requires 2 operands: " + instructionStr);
+                throw std::runtime_error("S-type instruction requires 2 operands: " + formatInstruction(opcode, operands));
             }
             
             auto rs2It = registers.find(operands[0]);
@@ -451,7 +499,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
         
         case InstructionFormat::B_TYPE: {
             if (operands.size() != 3) {
-                throw std::runtime_error("B-type instruction requires 3 operands: " + instructionStr);
+                throw std::runtime_error("B-type instruction requires 3 operands: " + formatInstruction(opcode, operands));
             }
             
             auto rs1It = registers.find(operands[0]);
@@ -476,7 +524,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
         
         case InstructionFormat::U_TYPE: {
             if (operands.size() != 2) {
-                throw std::runtime_error("U-type instruction requires 2 operands: " + instructionStr);
+                throw std::runtime_error("U-type instruction requires 2 operands: " + formatInstruction(opcode, operands));
             }
             
             auto rdIt = registers.find(operands[0]);
@@ -499,7 +547,7 @@ uint32_t assembleInstruction(const std::string& instructionStr,
         
         case InstructionFormat::J_TYPE: {
             if (operands.size() != 2 && operands.size() != 1) {
-                throw std::runtime_error("J-type instruction requires 1 or 2 operands: " + instructionStr);
+                throw std::runtime_error("J-type instruction requires 1 or 2 operands: " + formatInstruction(opcode, operands));
             }
             
             int rd, imm;
@@ -554,6 +602,378 @@ void writeMachineCode(std::ofstream& outFile, uint32_t machineCode) {
     outFile << std::bitset<8>((machineCode >> 24) & 0xFF).to_string() << std::endl;
 }
 
+// Function to format the file:line location of a source line for error messages
+std::string sourceLocation(const SourceLine& line) {
+    return *line.file + ":" + std::to_string(line.lineNumber);
+}
+
+// Function to find a character outside of double-quoted strings
+size_t findUnquoted(const std::string& str, char c) {
+    bool inQuotes = false;
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '"') inQuotes = !inQuotes;
+        else if (str[i] == c && !inQuotes) return i;
+    }
+    return std::string::npos;
+}
+
+// Function to split one line of source text into label, mnemonic and operands
+bool tokenizeLine(std::string text, SourceLine& line) {
+    // Remove comments
+    size_t commentPos = findUnquoted(text, '#');
+    if (commentPos != std::string::npos) {
+        text = text.substr(0, commentPos);
+    }
+    
+    text = trim(text);
+    if (text.empty()) return false;
+    
+    // Check for label
+    size_t labelPos = findUnquoted(text, ':');
+    if (labelPos != std::string::npos) {
+        line.label = trim(text.substr(0, labelPos));
+        text = trim(text.substr(labelPos + 1));
+    }
+    
+    // Split mnemonic from operands
+    size_t spacePos = text.find_first_of(" \t");
+    line.mnemonic = text.substr(0, spacePos);
+    if (spacePos != std::string::npos) {
+        line.operands = parseOperands(trim(text.substr(spacePos + 1)));
+    }
+    return true;
+}
+
+// Function to check if a path starts with a drive prefix such as C:
+bool hasDrivePrefix(const std::string& path) {
+    return path.size() >= 2 && isalpha(static_cast<unsigned char>(path[0])) && path[1] == ':';
+}
+
+// Function to check if a path is absolute (leading slash, leading backslash or drive prefix)
+bool isAbsolutePath(const std::string& path) {
+    if (path.empty()) return false;
+    return path[0] == '/' || path[0] == '\\' || hasDrivePrefix(path);
+}
+
+// Function to get the directory part of a path (with trailing separator)
+std::string directoryOf(const std::string& path) {
+    size_t slashPos = path.find_last_of("/\\");
+    if (slashPos != std::string::npos) return path.substr(0, slashPos + 1);
+    
+    // A bare drive prefix such as C:file.s is relative to that drive
+    if (hasDrivePrefix(path)) return path.substr(0, 2);
+    return "";
+}
+
+// Function to tokenize a buffer of source text into the lines of a cache entry
+void tokenizeBuffer(const char* data, size_t size, std::pair<const std::string, std::vector<SourceLine>>& entry) {
+    int lineNumber = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        const char* lineEnd = static_cast<const char*>(memchr(data + pos, '\n', size - pos));
+        size_t end = (lineEnd == nullptr) ? size : static_cast<size_t>(lineEnd - data);
+        lineNumber++;
+        
+        SourceLine line;
+        line.file = &entry.first;
+        line.lineNumber = lineNumber;
+        if (tokenizeLine(std::string(data + pos, end - pos), line)) {
+            entry.second.push_back(std::move(line));
+        }
+        pos = end + 1;
+    }
+}
+
+// Function to load and tokenize a source file, caching the token stream by canonical path.
+// Regular files are memory-mapped; pipes, devices and platforms without mmap are read with a stream.
+const std::pair<const std::string, std::vector<SourceLine>>& loadSourceFile(Preprocessor& pp, const std::string& path) {
+    std::string key = path;
+    
+#ifdef HAVE_MMAP
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        char* resolved = realpath(path.c_str(), nullptr);
+        if (resolved != nullptr) {
+            key = resolved;
+            free(resolved);
+        }
+    }
+#endif
+    
+    auto cached = pp.fileCache.find(key);
+    if (cached != pp.fileCache.end()) {
+        return *cached;
+    }
+    
+#ifdef HAVE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open input file " + path);
+    }
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        size_t size = static_cast<size_t>(st.st_size);
+        const char* data = nullptr;
+        if (size > 0) {
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Could not map input file " + path);
+            }
+            data = static_cast<const char*>(mapped);
+        }
+        
+        // Node keys in the cache are stable, so lines can point at them
+        auto& entry = *pp.fileCache.emplace(key, std::vector<SourceLine>()).first;
+        tokenizeBuffer(data, size, entry);
+        
+        if (data != nullptr) {
+            munmap(const_cast<char*>(data), size);
+        }
+        close(fd);
+        return entry;
+    }
+    close(fd);
+#endif
+    
+    std::ifstream inFile(path, std::ios::binary);
+    if (!inFile) {
+        throw std::runtime_error("Could not open input file " + path);
+    }
+    std::string contents((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+    
+    auto& entry = *pp.fileCache.emplace(key, std::vector<SourceLine>()).first;
+    tokenizeBuffer(contents.data(), contents.size(), entry);
+    return entry;
+}
+
+// Function to replace an .equ name used as an operand or as the offset of a memory operand
+std::string substituteEquate(const Preprocessor& pp, const std::string& operand) {
+    auto it = pp.equates.find(operand);
+    if (it != pp.equates.end()) return it->second;
+    
+    size_t openParen = operand.find('(');
+    if (openParen != std::string::npos) {
+        it = pp.equates.find(trim(operand.substr(0, openParen)));
+        if (it != pp.equates.end()) return it->second + operand.substr(openParen);
+    }
+    return operand;
+}
+
+// Function to replace \param, \@ and \() references inside a macro body token
+std::string substituteMacroArgs(const std::string& token, const Macro& macro,
+                                const std::vector<std::string>& args, int unique) {
+    if (token.find('\\') == std::string::npos) return token;
+    
+    std::string result;
+    size_t i = 0;
+    while (i < token.size()) {
+        if (token[i] != '\\' || i + 1 >= token.size()) {
+            result += token[i++];
+            continue;
+        }
+        if (token[i + 1] == '@') {
+            result += std::to_string(unique);
+            i += 2;
+            continue;
+        }
+        if (token.compare(i + 1, 2, "()") == 0) {
+            i += 3;
+            continue;
+        }
+        
+        size_t nameEnd = i + 1;
+        while (nameEnd < token.size() && (isalnum(token[nameEnd]) || token[nameEnd] == '_')) nameEnd++;
+        std::string name = token.substr(i + 1, nameEnd - i - 1);
+        
+        auto paramIt = std::find(macro.params.begin(), macro.params.end(), name);
+        if (paramIt == macro.params.end()) {
+            result += token[i++];
+            continue;
+        }
+        result += args[paramIt - macro.params.begin()];
+        i = nameEnd;
+    }
+    return result;
+}
+
+// Function to collect the body of a .macro or .rept block up to its matching terminator
+size_t collectBlock(const std::vector<SourceLine>& lines, size_t start,
+                    const std::string& open, const std::string& close,
+                    std::vector<SourceLine>& body) {
+    int depth = 1;
+    for (size_t i = start + 1; i < lines.size(); i++) {
+        std::string directive = lines[i].mnemonic;
+        std::transform(directive.begin(), directive.end(), directive.begin(), ::tolower);
+        
+        if (directive == open) depth++;
+        else if (directive == close && --depth == 0) return i;
+        body.push_back(lines[i]);
+    }
+    throw std::runtime_error(sourceLocation(lines[start]) + ": Missing " + close + " for " + open);
+}
+
+// Function to split macro parameters or arguments, which may be separated by commas and/or whitespace
+std::vector<std::string> splitMacroWords(const std::vector<std::string>& operands) {
+    std::vector<std::string> words;
+    for (const std::string& operand : operands) {
+        std::istringstream wordStream(operand);
+        std::string word;
+        while (wordStream >> word) words.push_back(word);
+    }
+    return words;
+}
+
+void preprocessLines(Preprocessor& pp, const std::vector<SourceLine>& lines);
+
+// Function to expand a macro invocation into token lines
+void expandMacro(Preprocessor& pp, const Macro& macro, const SourceLine& invocation) {
+    std::vector<std::string> args = splitMacroWords(invocation.operands);
+    if (args.size() != macro.params.size()) {
+        throw std::runtime_error(sourceLocation(invocation) + ": Macro " + macro.name + " expects " +
+                                 std::to_string(macro.params.size()) + " arguments");
+    }
+    if (pp.expansionDepth >= MAX_EXPANSION_DEPTH) {
+        throw std::runtime_error(sourceLocation(invocation) + ": Macro expansion too deep in " + macro.name);
+    }
+    
+    int unique = pp.uniqueCounter++;
+    std::vector<SourceLine> expanded;
+    expanded.reserve(macro.body.size());
+    for (const SourceLine& bodyLine : macro.body) {
+        SourceLine line;
+        line.label = substituteMacroArgs(bodyLine.label, macro, args, unique);
+        line.mnemonic = substituteMacroArgs(bodyLine.mnemonic, macro, args, unique);
+        for (const std::string& operand : bodyLine.operands) {
+            line.operands.push_back(substituteMacroArgs(operand, macro, args, unique));
+        }
+        line.file = bodyLine.file;
+        line.lineNumber = bodyLine.lineNumber;
+        expanded.push_back(std::move(line));
+    }
+    
+    pp.expansionDepth++;
+    preprocessLines(pp, expanded);
+    pp.expansionDepth--;
+}
+
+// Function to run the preprocessor directives (.include, .macro, .rept, .equ) over token lines
+void preprocessLines(Preprocessor& pp, const std::vector<SourceLine>& lines) {
+    for (size_t i = 0; i < lines.size(); i++) {
+        const SourceLine& line = lines[i];
+        
+        std::string directive = line.mnemonic;
+        std::transform(directive.begin(), directive.end(), directive.begin(), ::tolower);
+        
+        auto macroIt = pp.macros.find(directive);
+        bool isPreprocessorLine = directive == ".include" || directive == ".macro" || directive == ".endm" ||
+                                  directive == ".rept" || directive == ".endr" || directive == ".equ" ||
+                                  macroIt != pp.macros.end();
+        
+        if (!isPreprocessorLine) {
+            SourceLine out = line;
+            for (std::string& operand : out.operands) {
+                operand = substituteEquate(pp, operand);
+            }
+            pp.output.push_back(std::move(out));
+            continue;
+        }
+        
+        // Keep a label written in front of a directive or macro invocation
+        if (!line.label.empty()) {
+            SourceLine labelLine;
+            labelLine.label = line.label;
+            labelLine.file = line.file;
+            labelLine.lineNumber = line.lineNumber;
+            pp.output.push_back(std::move(labelLine));
+        }
+        
+        if (directive == ".include") {
+            if (line.operands.size() != 1) {
+                throw std::runtime_error(sourceLocation(line) + ": .include requires a file name");
+            }
+            std::string path = line.operands[0];
+            if (path.size() >= 2 && path.front() == '"' && path.back() == '"') {
+                path = path.substr(1, path.size() - 2);
+            }
+            if (!isAbsolutePath(path)) {
+                path = directoryOf(*line.file) + path;
+            }
+            
+            const std::pair<const std::string, std::vector<SourceLine>>* loaded;
+            try {
+                loaded = &loadSourceFile(pp, path);
+            } catch (const std::exception& e) {
+                throw std::runtime_error(sourceLocation(line) + ": " + e.what());
+            }
+            const auto& entry = *loaded;
+            if (std::find(pp.includeStack.begin(), pp.includeStack.end(), entry.first) != pp.includeStack.end()) {
+                throw std::runtime_error(sourceLocation(line) + ": Recursive include of " + entry.first);
+            }
+            
+            pp.includeStack.push_back(entry.first);
+            preprocessLines(pp, entry.second);
+            pp.includeStack.pop_back();
+        }
+        else if (directive == ".macro") {
+            std::vector<std::string> words = splitMacroWords(line.operands);
+            if (words.empty()) {
+                throw std::runtime_error(sourceLocation(line) + ": .macro requires a name");
+            }
+            
+            Macro macro;
+            macro.name = words[0];
+            std::transform(macro.name.begin(), macro.name.end(), macro.name.begin(), ::tolower);
+            macro.params.assign(words.begin() + 1, words.end());
+            i = collectBlock(lines, i, ".macro", ".endm", macro.body);
+            pp.macros[macro.name] = std::move(macro);
+        }
+        else if (directive == ".rept") {
+            if (line.operands.size() != 1) {
+                throw std::runtime_error(sourceLocation(line) + ": .rept requires a count");
+            }
+            std::string countStr = substituteEquate(pp, line.operands[0]);
+            int count = -1;
+            if (isNumber(countStr)) {
+                try {
+                    count = parseNumber(countStr);
+                } catch (const std::exception&) {
+                    // A bare sign or an out-of-range value is reported as an invalid count below
+                }
+            }
+            if (count < 0) {
+                throw std::runtime_error(sourceLocation(line) + ": Invalid .rept count: " + line.operands[0]);
+            }
+            if (pp.expansionDepth >= MAX_EXPANSION_DEPTH) {
+                throw std::runtime_error(sourceLocation(line) + ": .rept nested too deeply");
+            }
+            
+            std::vector<SourceLine> body;
+            i = collectBlock(lines, i, ".rept", ".endr", body);
+            
+            pp.expansionDepth++;
+            for (int n = count; n > 0; n--) {
+                preprocessLines(pp, body);
+            }
+            pp.expansionDepth--;
+        }
+        else if (directive == ".equ") {
+            if (line.operands.size() != 2) {
+                throw std::runtime_error(sourceLocation(line) + ": .equ requires a name and a value");
+            }
+            if (pp.registers.count(line.operands[0])) {
+                throw std::runtime_error(sourceLocation(line) + ": .equ cannot redefine register " + line.operands[0]);
+            }
+            pp.equates[line.operands[0]] = substituteEquate(pp, line.operands[1]);
+        }
+        else if (directive == ".endm" || directive == ".endr") {
+            throw std::runtime_error(sourceLocation(line) + ": " + directive + " without matching block");
+        }
+        else {
+            expandMacro(pp, macroIt->second, line);
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
     // Check command line arguments
     if (argc < 2) {
@@ -569,51 +989,34 @@ int main(int argc, char* argv[]) {
     std::unordered_map<std::string, Instruction> instructions = createInstructionMap();
     std::unordered_map<std::string, int> registers = createRegisterMap();
     
-    // First pass: Build symbol table
-    std::ifstream inFile(inputFile);
-    if (!inFile) {
-        std::cerr << "Error: Could not open input file " << inputFile << std::endl;
+    // Preprocess: expand .include, .macro, .rept and .equ into token lines
+    Preprocessor pp;
+    pp.registers = registers;
+    try {
+        const auto& entry = loadSourceFile(pp, inputFile);
+        pp.includeStack.push_back(entry.first);
+        preprocessLines(pp, entry.second);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
     
+    // First pass: Build symbol table
     std::unordered_map<std::string, uint32_t> symbolTable;
     uint32_t address = 0;
-    std::string line;
     
-    while (std::getline(inFile, line)) {
-        // Remove comments
-        size_t commentPos = line.find('#');
-        if (commentPos != std::string::npos) {
-            line = line.substr(0, commentPos);
-        }
-        
-        line = trim(line);
-        if (line.empty()) continue;
-        
-        // Check for label
-        size_t labelPos = line.find(':');
-        if (labelPos != std::string::npos) {
-            std::string label = trim(line.substr(0, labelPos));
-            symbolTable[label] = address;
-            
-            // Check if there's an instruction after the label
-            line = trim(line.substr(labelPos + 1));
-            if (line.empty()) continue;
+    for (const SourceLine& line : pp.output) {
+        if (!line.label.empty()) {
+            symbolTable[line.label] = address;
         }
         
         // Increment address by 4 bytes for each instruction
-        address += 4;
+        if (!line.mnemonic.empty()) {
+            address += 4;
+        }
     }
     
-    inFile.close();
-    
     // Second pass: Assemble instructions
-    inFile.open(inputFile);
-    if (!inFile) {
-        std::cerr << "Error: Could not open input file " << inputFile << std::endl;
-        return 1;
-    }
-    
     std::ofstream outFile(outputFile);
     if (!outFile) {
         std::cerr << "Error: Could not open output file " << outputFile << std::endl;
@@ -621,26 +1024,12 @@ int main(int argc, char* argv[]) {
     }
     
     address = 0;
-    while (std::getline(inFile, line)) {
-        // Remove comments
-        size_t commentPos = line.find('#');
-        if (commentPos != std::string::npos) {
-            line = line.substr(0, commentPos);
-        }
-        
-        line = trim(line);
-        if (line.empty()) continue;
-        
-        // Remove label if present
-        size_t labelPos = line.find(':');
-        if (labelPos != std::string::npos) {
-            line = trim(line.substr(labelPos + 1));
-            if (line.empty()) continue;
-        }
+    for (const SourceLine& line : pp.output) {
+        if (line.mnemonic.empty()) continue;
         
         try {
             // Assemble the instruction
-            uint32_t machineCode = assembleInstruction(line, instructions, registers, symbolTable, address);
+            uint32_t machineCode = assembleInstruction(line.mnemonic, line.operands, instructions, registers, symbolTable, address);
             
             // Write the machine code to output file
             writeMachineCode(outFile, machineCode);
@@ -648,13 +1037,13 @@ int main(int argc, char* argv[]) {
             // Increment address by 4 bytes for each instruction
             address += 4;
         } catch (const std::exception& e) {
-            std::cerr << "Error assembling instruction: " << line << std::endl;
+            std::cerr << "Error assembling instruction at " << sourceLocation(line) << ": "
+                      << formatInstruction(line.mnemonic, line.operands) << std::endl;
             std::cerr << e.what() << std::endl;
             return 1;
         }
     }
     
-    inFile.close();
     outFile.close();
     
     std::cout << "Assembly successful. Output written to " << outputFile << std::endl;